@@ -9,28 +9,206 @@
 #include <string>
 #include <iostream>
 #include <variant>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <sstream>
+#include <iomanip>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <cerrno>
+#include <cctype>
+
+// Deterministic simulation: build with -DDETERMINISTIC (make compile-deterministic) to run positions,
+// velocities, echo geometry and collisions on the fixed-point types below instead of float (see Scalar and Vec2).
+// Integer math gives the same bits regardless of compiler, optimization level or SIMD path. The little state
+// that stays float (charges, intensity, timers, sonar rays) only needs strict IEEE math, which is why that
+// target builds with -ffp-contract=off and must not get -ffast-math.
+
+// Q16.16 fixed point number
+struct Fixed {
+    static constexpr int fracBits = 16;
+    static constexpr int32_t one = 1 << fracBits;
+    int32_t raw = 0;
+
+    static constexpr Fixed fromRaw(int32_t r) { Fixed f; f.raw = r; return f; }
+    static constexpr Fixed fromInt(int32_t i) { return fromRaw(i * one); }
+    static Fixed fromFloat(float f) { return fromRaw((int32_t)std::lround(f * (float)one)); }
+    float toFloat() const { return (float)raw / (float)one; }
+
+    // Products and quotients go through 64 bits so the intermediate can't overflow
+    Fixed operator+(Fixed o) const { return fromRaw(raw + o.raw); }
+    Fixed operator-(Fixed o) const { return fromRaw(raw - o.raw); }
+    Fixed operator-() const { return fromRaw(-raw); }
+    Fixed operator*(Fixed o) const { return fromRaw((int32_t)(((int64_t)raw * o.raw) >> fracBits)); }
+    Fixed operator/(Fixed o) const { return fromRaw((int32_t)((int64_t)raw * one / o.raw)); }
+    Fixed operator/(int32_t d) const { return fromRaw(raw / d); }
+    Fixed& operator+=(Fixed o) { raw += o.raw; return *this; }
+    Fixed& operator-=(Fixed o) { raw -= o.raw; return *this; }
+    bool operator==(Fixed o) const { return raw == o.raw; }
+    bool operator!=(Fixed o) const { return raw != o.raw; }
+    bool operator<(Fixed o) const { return raw < o.raw; }
+    bool operator>(Fixed o) const { return raw > o.raw; }
+    bool operator<=(Fixed o) const { return raw <= o.raw; }
+    bool operator>=(Fixed o) const { return raw >= o.raw; }
+};
+
+struct FixedVec2 {
+    Fixed x;
+    Fixed y;
+
+    FixedVec2() = default;
+    FixedVec2(Fixed x_, Fixed y_) : x(x_), y(y_) {}
+    static FixedVec2 fromVector2f(const sf::Vector2f& v) { return FixedVec2(Fixed::fromFloat(v.x), Fixed::fromFloat(v.y)); }
+    sf::Vector2f toVector2f() const { return sf::Vector2f(x.toFloat(), y.toFloat()); }
+
+    FixedVec2 operator+(FixedVec2 o) const { return FixedVec2(x + o.x, y + o.y); }
+    FixedVec2 operator-(FixedVec2 o) const { return FixedVec2(x - o.x, y - o.y); }
+    FixedVec2 operator*(Fixed s) const { return FixedVec2(x * s, y * s); }
+    FixedVec2& operator+=(FixedVec2 o) { x += o.x; y += o.y; return *this; }
+};
+
+// Table based trig on angles in degrees (turretAngle and friends), 4096 steps per turn.
+// The table is filled once and rounded to Q16.16, so libm's last-bit differences don't make it into the results.
+constexpr int trigTableSize = 4096;
+
+inline const std::array<Fixed, trigTableSize>& sinTable() {
+    static const std::array<Fixed, trigTableSize> table = [] {
+        std::array<Fixed, trigTableSize> t;
+        for (int i = 0; i < trigTableSize; ++i) {
+            double s = std::sin(2.0 * 3.14159265358979323846 * i / trigTableSize);
+            t[i] = Fixed::fromRaw((int32_t)std::lround(s * Fixed::one));
+        }
+        return t;
+    }();
+    return table;
+}
+
+// Nearest table index for an angle, wrapped into [0, trigTableSize)
+inline int trigIndex(Fixed deg) {
+    const int64_t fullTurn = 360LL * Fixed::one;
+    int64_t scaled = (int64_t)deg.raw * trigTableSize + fullTurn / 2;
+    int64_t index = scaled / fullTurn;
+    if (scaled % fullTurn < 0) --index; // floor for negative angles
+    return (int)(((index % trigTableSize) + trigTableSize) % trigTableSize);
+}
+
+inline Fixed fixedSinDeg(Fixed deg) { return sinTable()[trigIndex(deg)]; }
+inline Fixed fixedCosDeg(Fixed deg) { return sinTable()[(trigIndex(deg) + trigTableSize / 4) % trigTableSize]; }
+
+// Integer collision kernels. Squared distances are compared in raw 64-bit (Q32.32), so no sqrt is needed
+inline int64_t fixedLengthSq(FixedVec2 v) {
+    return (int64_t)v.x.raw * v.x.raw + (int64_t)v.y.raw * v.y.raw;
+}
+
+inline bool fixedCirclesOverlap(FixedVec2 a, Fixed ra, FixedVec2 b, Fixed rb) {
+    int64_t r = (int64_t)ra.raw + rb.raw;
+    return fixedLengthSq(a - b) <= r * r;
+}
+
+// Rectangle centered on center, with its long side along the unit vector axis
+inline bool fixedRectHitsCircle(FixedVec2 center, FixedVec2 axis, Fixed halfW, Fixed halfH, FixedVec2 circle, Fixed r) {
+    // Circle center in the rectangle's local space (rotate by -angle)
+    FixedVec2 d = circle - center;
+    Fixed lx = d.x * axis.x + d.y * axis.y;
+    Fixed ly = d.y * axis.x - d.x * axis.y;
+
+    // Closest point on the rectangle, then circle-vs-point
+    Fixed cx = std::max(-halfW, std::min(lx, halfW));
+    Fixed cy = std::max(-halfH, std::min(ly, halfH));
+    return fixedLengthSq(FixedVec2(lx - cx, ly - cy)) <= (int64_t)r.raw * r.raw;
+}
+
+// Simulation number types. Everything that decides what happens in the game (positions, velocities, the turret
+// angle, echo geometry, collisions) is written against Scalar, Vec2 and the helpers below, so both builds run the
+// same code. They are plain float by default, and the fixed-point types above in a DETERMINISTIC build.
+// This is the only place the two builds differ.
+#ifdef DETERMINISTIC
+using Scalar = Fixed;
+using Vec2 = FixedVec2;
+constexpr bool deterministicBuild = true;
+
+inline Scalar toScalar(float f) { return Fixed::fromFloat(f); }
+inline float toFloat(Scalar s) { return s.toFloat(); }
+inline Vec2 toVec2(const sf::Vector2f& v) { return FixedVec2::fromVector2f(v); }
+inline sf::Vector2f toVector2f(const Vec2& v) { return v.toVector2f(); }
+inline Scalar sinDeg(Scalar deg) { return fixedSinDeg(deg); }
+inline Scalar cosDeg(Scalar deg) { return fixedCosDeg(deg); }
+inline bool circlesOverlap(Vec2 a, Scalar ra, Vec2 b, Scalar rb) { return fixedCirclesOverlap(a, ra, b, rb); }
+inline bool rectHitsCircle(Vec2 center, Vec2 axis, Scalar halfW, Scalar halfH, Vec2 circle, Scalar r) {
+    return fixedRectHitsCircle(center, axis, halfW, halfH, circle, r);
+}
+#else
+using Scalar = float;
+using Vec2 = sf::Vector2f;
+constexpr bool deterministicBuild = false;
+
+inline Scalar toScalar(float f) { return f; }
+inline float toFloat(Scalar s) { return s; }
+inline Vec2 toVec2(const sf::Vector2f& v) { return v; }
+inline sf::Vector2f toVector2f(const Vec2& v) { return v; }
+inline Scalar sinDeg(Scalar deg) { return std::sin(deg * 3.14159265f / 180.f); }
+inline Scalar cosDeg(Scalar deg) { return std::cos(deg * 3.14159265f / 180.f); }
+inline bool circlesOverlap(Vec2 a, Scalar ra, Vec2 b, Scalar rb) {
+    Vec2 d = a - b;
+    float r = ra + rb;
+    return d.x*d.x + d.y*d.y <= r * r;
+}
+// Same steps as fixedRectHitsCircle
+inline bool rectHitsCircle(Vec2 center, Vec2 axis, Scalar halfW, Scalar halfH, Vec2 circle, Scalar r) {
+    Vec2 d = circle - center;
+    float lx = d.x * axis.x + d.y * axis.y;
+    float ly = d.y * axis.x - d.x * axis.y;
+    float dx = lx - std::max(-halfW, std::min(lx, halfW));
+    float dy = ly - std::max(-halfH, std::min(ly, halfH));
+    return dx*dx + dy*dy <= r * r;
+}
+#endif
 
 struct Bullet {
     sf::CircleShape shape;
-    sf::Vector2f velocity;
+    Vec2 velocity;
+
+    // Setting the position also moves the shape, which is only used for drawing
+    void set_position(const Vec2& p) {
+        position = p;
+        shape.setPosition(toVector2f(p));
+    }
+    Vec2 get_position() const {
+        return position;
+    }
+private:
+    Vec2 position;
 };
 
 class Enemy {
 private:
     bool visible = false;
-    sf::Vector2f velocity;
+    Vec2 position;
+    Vec2 velocity;
 public:
     sf::CircleShape shape;
     float visibilityTimer = 0.f; // seconds remaining the enemy stays "visible"
 
     void set_visibility(bool v);
-    auto set_velocity(const sf::Vector2f& vel) {
+    auto set_velocity(const Vec2& vel) {
         velocity = vel;
         return velocity;
     }
-    sf::Vector2f get_velocity() const {
+    Vec2 get_velocity() const {
         return velocity;
     }
+    // Setting the position also moves the shape, which drawing and the sonar read
+    void set_position(const Vec2& p) {
+        position = p;
+        shape.setPosition(toVector2f(p));
+    }
+    Vec2 get_position() const {
+        return position;
+    }
 };
 
 void Enemy::set_visibility(bool v) {
@@ -47,8 +225,9 @@ void Enemy::set_visibility(bool v) {
 
 class EchoBase {
 public:
-    float elapsedTime = 0.f;
-    sf::Vector2f velocity;
+    Scalar elapsedTime = toScalar(0.f);
+    Vec2 velocity; // direction the echo travels in
+    Vec2 position; // center of the echo
     
     //Virtual destructor ensures correct cleanup when deleting Echo or BigEcho through a base pointer
     virtual ~EchoBase() = default;
@@ -59,75 +238,453 @@ public:
 
 struct Echo : public EchoBase {
     sf::RectangleShape shape;
-    float length;
+    Scalar length;
     void update(float dt, float shrinkRate, float speed, float thickness, const sf::Vector2f& center) override {
-        elapsedTime += dt;
+        Scalar step = toScalar(dt);
+        elapsedTime += step;
         
         // Rectangle shrinks at constant rate
-        length = (length - dt * shrinkRate);
+        length -= step * toScalar(shrinkRate);
         
         // Update rectangle size according to the above change
-        shape.setSize(sf::Vector2f(length, thickness));
-        shape.setOrigin(sf::Vector2f(length / 2.f, thickness / 2.f)); // recenter as it shrinks
+        float drawLength = toFloat(length);
+        shape.setSize(sf::Vector2f(drawLength, thickness));
+        shape.setOrigin(sf::Vector2f(drawLength / 2.f, thickness / 2.f)); // recenter as it shrinks
         
         // Move outward from center
-        sf::Vector2f offset = velocity * speed * elapsedTime;
+        position = toVec2(center) + velocity * (toScalar(speed) * elapsedTime);
         // ^ The above line caluclates how far an echo has traveled by multiplying its direction by speed and total time alive
-        shape.setPosition(center + offset);
+        shape.setPosition(toVector2f(position));
     }
 
     bool hitsEnemy(const Enemy& enemy, float thickness) const override {
-    if (length <= 0.f) return false;
-
-    sf::Vector2f enemyPos = enemy.shape.getPosition();
-    float enemyR = enemy.shape.getRadius();
-
-    sf::Transform inv = shape.getTransform().getInverse();
-    sf::Vector2f local = inv.transformPoint(enemyPos);
+    if (length <= toScalar(0.f)) return false;
 
-    float halfW = length / 2.f;
-    float halfH = thickness / 2.f;
-
-    float cx = std::max(-halfW, std::min(local.x, halfW));
-    float cy = std::max(-halfH, std::min(local.y, halfH));
-
-    float dx = local.x - cx;
-    float dy = local.y - cy;
-
-    return (dx*dx + dy*dy) <= enemyR * enemyR;
+    // The rectangle's long side lies perpendicular to the direction the echo travels
+    Vec2 axis(-velocity.y, velocity.x);
+    return rectHitsCircle(position, axis, length / 2, toScalar(thickness) / 2,
+                          enemy.get_position(), toScalar(enemy.shape.getRadius()));
     }
 
 };
 
 struct BigEcho : public EchoBase {
     sf::CircleShape shape;
-    float radius;
+    Scalar radius;
     void update(float dt, float shrinkRate, float speed, float thickness, const sf::Vector2f& center) override {
-        elapsedTime += dt;
+        Scalar step = toScalar(dt);
+        elapsedTime += step;
         
         // Circle shrinks at constant rate
-        radius = (radius - dt * shrinkRate);
+        radius -= step * toScalar(shrinkRate);
+        position = toVec2(center);
         
         // Update circle size according to the above change
-        shape.setRadius(radius);
-        shape.setOrigin(sf::Vector2f(radius, radius)); // recenter as it shrinks
+        float drawRadius = toFloat(radius);
+        shape.setRadius(drawRadius);
+        shape.setOrigin(sf::Vector2f(drawRadius, drawRadius)); // recenter as it shrinks
         shape.setPosition(center);
     }
     bool hitsEnemy(const Enemy& enemy, float) const override {
-    if (radius <= 0.f) return false;
+    if (radius <= toScalar(0.f)) return false;
 
-    sf::Vector2f ep = enemy.shape.getPosition();
-    sf::Vector2f cp = shape.getPosition();
-    float er = enemy.shape.getRadius();
+    return circlesOverlap(position, radius, enemy.get_position(), toScalar(enemy.shape.getRadius()));
+}
 
-    float dx = ep.x - cp.x;
-    float dy = ep.y - cp.y;
-    float r = radius + er;
+};
+// Bounding volume hierarchy over the enemy circles, used by the sonar's ray casts.
+// The tree is built once and then refit every frame: enemies move but the tree topology stays,
+// so only the boxes are recomputed. It is only rebuilt when the number of enemies changes.
+struct BVHNode {
+    sf::Vector2f boxMin;
+    sf::Vector2f boxMax;
+    int left = -1;  // child node indices, -1 for leaves
+    int right = -1;
+    int first = 0;  // leaves: range into EnemyBVH::indices
+    int count = 0;
+};
+
+class EnemyBVH {
+private:
+    static constexpr int maxLeafSize = 4;
+    std::vector<sf::Vector2f> centers; // scratch used while building
+
+    int buildNode(int first, int count) {
+        int nodeIndex = (int)nodes.size();
+        nodes.push_back(BVHNode());
+        if (count <= maxLeafSize) {
+            nodes[nodeIndex].first = first;
+            nodes[nodeIndex].count = count;
+            return nodeIndex;
+        }
 
-    return (dx*dx + dy*dy) <= r * r;
+        // Split along the longest axis of the centers, at the median
+        sf::Vector2f cmin = centers[indices[first]];
+        sf::Vector2f cmax = cmin;
+        for (int i = first; i < first + count; ++i) {
+            sf::Vector2f c = centers[indices[i]];
+            cmin.x = std::min(cmin.x, c.x); cmin.y = std::min(cmin.y, c.y);
+            cmax.x = std::max(cmax.x, c.x); cmax.y = std::max(cmax.y, c.y);
+        }
+        bool splitX = (cmax.x - cmin.x) >= (cmax.y - cmin.y);
+        int half = count / 2;
+        std::nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count,
+            [&](int a, int b) { return splitX ? centers[a].x < centers[b].x : centers[a].y < centers[b].y; });
+
+        // children are always pushed after their parent, which refit() relies on
+        int left = buildNode(first, half);
+        int right = buildNode(first + half, count - half);
+        nodes[nodeIndex].left = left;
+        nodes[nodeIndex].right = right;
+        return nodeIndex;
+    }
+
+public:
+    std::vector<BVHNode> nodes;
+    std::vector<int> indices; // enemy indices, grouped by leaf
+
+    void build(const std::vector<Enemy>& enemies) {
+        nodes.clear();
+        refitsSinceBuild = 0;
+        indices.resize(enemies.size());
+        centers.resize(enemies.size());
+        for (size_t i = 0; i < enemies.size(); ++i) {
+            indices[i] = (int)i;
+            centers[i] = enemies[i].shape.getPosition();
+        }
+        if (enemies.empty()) return;
+        nodes.reserve(2 * enemies.size() / maxLeafSize + 1);
+        buildNode(0, (int)enemies.size());
+        refit(enemies);
+    }
+
+    void refit(const std::vector<Enemy>& enemies) {
+        ++refitsSinceBuild;
+        // Walk backwards so both children are done before their parent
+        for (int n = (int)nodes.size() - 1; n >= 0; --n) {
+            BVHNode& node = nodes[n];
+            if (node.left < 0) {
+                node.boxMin = sf::Vector2f(INFINITY, INFINITY);
+                node.boxMax = sf::Vector2f(-INFINITY, -INFINITY);
+                for (int i = node.first; i < node.first + node.count; ++i) {
+                    const Enemy& e = enemies[indices[i]];
+                    sf::Vector2f p = e.shape.getPosition();
+                    float r = e.shape.getRadius();
+                    node.boxMin.x = std::min(node.boxMin.x, p.x - r); node.boxMin.y = std::min(node.boxMin.y, p.y - r);
+                    node.boxMax.x = std::max(node.boxMax.x, p.x + r); node.boxMax.y = std::max(node.boxMax.y, p.y + r);
+                }
+            } else {
+                const BVHNode& l = nodes[node.left];
+                const BVHNode& r = nodes[node.right];
+                node.boxMin = sf::Vector2f(std::min(l.boxMin.x, r.boxMin.x), std::min(l.boxMin.y, r.boxMin.y));
+                node.boxMax = sf::Vector2f(std::max(l.boxMax.x, r.boxMax.x), std::max(l.boxMax.y, r.boxMax.y));
+            }
+        }
+    }
+
+    int refitsSinceBuild = 0; // refits degrade the tree as enemies move, so it is rebuilt now and then during idle time
+
+    // Called once per frame. Refitting assumes "same enemy count => same indices". That holds in this game because
+    // enemies are only erased one at a time (changing the count), and spawnWave() only refills an empty vector.
+    // Anything that removes and adds enemies in the same frame has to call build() instead.
+    void update(const std::vector<Enemy>& enemies) {
+        if (indices.size() != enemies.size()) build(enemies);
+        else refit(enemies);
+    }
+
+    // Returns the index of the first enemy hit along origin + dir * t (dir normalized), or -1.
+    // hitDistance receives t of the hit.
+    int raycast(const std::vector<Enemy>& enemies, sf::Vector2f origin, sf::Vector2f dir, float maxDistance, float& hitDistance) const {
+        int hitEnemy = -1;
+        hitDistance = maxDistance;
+        if (nodes.empty()) return hitEnemy;
+
+        // dividing by zero gives +-inf, which the slab test below handles
+        sf::Vector2f invDir(1.f / dir.x, 1.f / dir.y);
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const BVHNode& node = nodes[stack[--top]];
+
+            // Ray vs box (slab test)
+            float tx1 = (node.boxMin.x - origin.x) * invDir.x;
+            float tx2 = (node.boxMax.x - origin.x) * invDir.x;
+            float ty1 = (node.boxMin.y - origin.y) * invDir.y;
+            float ty2 = (node.boxMax.y - origin.y) * invDir.y;
+            float tNear = std::max(std::min(tx1, tx2), std::min(ty1, ty2));
+            float tFar = std::min(std::max(tx1, tx2), std::max(ty1, ty2));
+            if (tFar < 0.f || tNear > tFar || tNear > hitDistance) continue;
+
+            if (node.left >= 0) {
+                stack[top++] = node.left;
+                stack[top++] = node.right;
+                continue;
+            }
+
+            // Ray vs circle for each enemy in the leaf
+            for (int i = node.first; i < node.first + node.count; ++i) {
+                const Enemy& e = enemies[indices[i]];
+                sf::Vector2f oc = e.shape.getPosition() - origin;
+                float r = e.shape.getRadius();
+                float along = oc.x * dir.x + oc.y * dir.y; // projection of the center onto the ray
+                float perp2 = oc.x * oc.x + oc.y * oc.y - along * along;
+                if (perp2 > r * r) continue;
+                float halfChord = std::sqrt(r * r - perp2);
+                float t = along - halfChord;
+                if (t < 0.f) t = along + halfChord; // origin is inside the circle
+                if (t >= 0.f && t < hitDistance) {
+                    hitDistance = t;
+                    hitEnemy = indices[i];
+                }
+            }
+        }
+        return hitEnemy;
+    }
+};
+
+struct SonarHit {
+    int enemy = -1;          // index into enemies, -1 if the ray found nothing
+    float distance = 0.f;    // distance to the first hit (or max range on a miss)
+    float returnDelay = 0.f; // seconds for the ping to travel out and back (0 on a miss, nothing comes back)
+};
+
+// Sonar: a release casts a fan of rays around the turret direction and reports what each one hit first
+struct Sonar {
+    std::vector<SonarHit> hits; // one entry per ray from the last ping
+    std::vector<sf::Vector2f> rayEnds; // where each ray stopped, for drawing
+    float displayTimer = 0.f; // seconds the last ping stays on screen
+
+    void cast(const EnemyBVH& bvh, const std::vector<Enemy>& enemies, const sf::Vector2f& origin,
+              float centerDeg, float fanDeg, int rayCount, float maxRange, float soundSpeed) {
+        if (rayCount < 0) rayCount = 0;
+        hits.resize(rayCount);
+        rayEnds.resize(rayCount);
+        for (int i = 0; i < rayCount; ++i) {
+            // spread rays evenly across the fan, centered on centerDeg
+            float offset = rayCount > 1 ? fanDeg * ((float)i / (rayCount - 1) - 0.5f) : 0.f;
+            Scalar deg = toScalar(centerDeg + offset);
+            sf::Vector2f dir(toFloat(cosDeg(deg)), toFloat(sinDeg(deg)));
+
+            SonarHit& hit = hits[i];
+            hit.enemy = bvh.raycast(enemies, origin, dir, maxRange, hit.distance);
+            hit.returnDelay = hit.enemy >= 0 ? 2.f * hit.distance / soundSpeed : 0.f;
+            rayEnds[i] = origin + dir * hit.distance;
+        }
+    }
+
+    // Reveal every enemy hit by the last ping
+    void reveal(std::vector<Enemy>& enemies, float revealTime) const {
+        for (const SonarHit& hit : hits) {
+            if (hit.enemy < 0) continue;
+            Enemy& e = enemies[hit.enemy];
+            e.set_visibility(true);
+            e.visibilityTimer = std::max(e.visibilityTimer, revealTime);
+        }
+    }
+};
+
+// Puts an enemy of the given wave somewhere on the spawn circle, heading for the center.
+// Angle and speed come from raw rng() output, since the std:: distributions aren't the same across standard libraries
+void placeEnemy(Enemy& e, std::mt19937& rng, int waveNumber, const Vec2& center, Scalar spawnRadius) {
+    Scalar a = toScalar((rng() % 36000u) / 100.f); // random angle in degrees, to a hundredth
+    Vec2 outward(cosDeg(a), sinDeg(a));
+    // speed increases with wave number + some random variation in [-10, 10]
+    Scalar speed = toScalar(40.f + 8.f * waveNumber + (rng() % 2001u) / 100.f - 10.f);
+    e.set_position(center + outward * spawnRadius);
+    e.set_velocity(outward * -speed); // straight back towards the center
 }
 
+// Reads a seed given as a plain decimal number. Rejects anything strtoul would quietly bend into range:
+// signs (it wraps -1 to ULONG_MAX), values above UINT_MAX and trailing junk
+bool parseSeed(const char* text, unsigned int& seed) {
+    const char* digits = text;
+    while (std::isspace((unsigned char)*digits)) ++digits;
+    if (*digits == '-' || *digits == '+') return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long parsed = std::strtoul(digits, &end, 10);
+    if (end == digits || *end != '\0' || errno == ERANGE || parsed > UINT_MAX) return false;
+    seed = (unsigned int)parsed;
+    return true;
+}
+
+// A few widgets rendered once into a texture just big enough to hold them, then blitted every frame.
+// The texture starts transparent and is drawn into with normal alpha blending, so it ends up holding
+// premultiplied colors. It must be blitted with a premultiplied blend, or soft edges get darkened twice.
+class CachedLayer {
+public:
+    CachedLayer() = default;
+    CachedLayer(const CachedLayer&) = delete; // the sprite points at our own texture
+    CachedLayer& operator=(const CachedLayer&) = delete;
+
+    // bounds is the screen area the widgets cover. If the texture can't be created, returns false
+    // and drawTo() just draws the widgets directly
+    bool create(const sf::FloatRect& bounds, std::function<void(sf::RenderTarget&)> draw) {
+        drawWidgets = std::move(draw);
+        // Whole pixels, padded a little so anti-aliased edges aren't cut off
+        float left = std::floor(bounds.position.x) - 2.f;
+        float top = std::floor(bounds.position.y) - 2.f;
+        float width = std::ceil(bounds.position.x + bounds.size.x) + 2.f - left;
+        float height = std::ceil(bounds.position.y + bounds.size.y) + 2.f - top;
+        if (!texture.resize({(unsigned int)width, (unsigned int)height})) return false;
+        texture.setView(sf::View(sf::FloatRect({left, top}, {width, height})));
+        sprite.setTexture(texture.getTexture(), true);
+        sprite.setPosition(sf::Vector2f(left, top));
+        cached = true;
+        render();
+        return true;
+    }
+
+    // Call again whenever one of the widgets changes
+    void render() {
+        if (!cached) return;
+        texture.clear(sf::Color::Transparent);
+        drawWidgets(texture);
+        texture.display();
+    }
+
+    void drawTo(sf::RenderTarget& target) const {
+        if (cached) target.draw(sprite, sf::RenderStates(premultipliedAlpha));
+        else if (drawWidgets) drawWidgets(target);
+    }
+
+private:
+    inline static const sf::BlendMode premultipliedAlpha{sf::BlendMode::Factor::One, sf::BlendMode::Factor::OneMinusSrcAlpha};
+    sf::RenderTexture texture;
+    sf::Sprite sprite{texture.getTexture()};
+    std::function<void(sf::RenderTarget&)> drawWidgets;
+    bool cached = false;
+};
+
+// Smallest rectangle containing both
+inline sf::FloatRect boundsUnion(const sf::FloatRect& a, const sf::FloatRect& b) {
+    sf::Vector2f topLeft(std::min(a.position.x, b.position.x), std::min(a.position.y, b.position.y));
+    sf::Vector2f bottomRight(std::max(a.position.x + a.size.x, b.position.x + b.size.x),
+                             std::max(a.position.y + a.size.y, b.position.y + b.size.y));
+    return sf::FloatRect(topLeft, bottomRight - topLeft);
+}
+
+// Numbers shown in the HUD. Setting an sf::Text string lays out all of its glyphs again,
+// so the text is only rebuilt when one of these actually changes.
+struct HudStats {
+    int wave = -1;
+    int enemies = -1;
+    int bullets = -1;
+    int intensity = -1;
+
+    // Returns true if anything changed since the last call
+    bool update(int w, int e, int b, int i) {
+        if (w == wave && e == enemies && b == bullets && i == intensity) return false;
+        wave = w;
+        enemies = e;
+        bullets = b;
+        intensity = i;
+        return true;
+    }
+
+    std::string toString() const {
+        return "Wave: " + std::to_string(wave) +
+               "    Enemies: " + std::to_string(enemies) +
+               "    Bullets: " + std::to_string(bullets) +
+               "    Intensity: " + std::to_string(intensity);
+    }
+};
+
+// Paces the game loop to a fixed frame time. OS sleeps often overshoot by a millisecond or more,
+// so it sleeps for most of the remaining time and spins for the last bit.
+// Leftover time at the end of a frame can be spent on idle tasks (deferred work like index rebuilds).
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FramePacer(float targetSeconds, float spinSeconds = 0.002f) {
+        setTarget(targetSeconds);
+        spin = toDuration(spinSeconds);
+        restart();
+    }
+
+    void setTarget(float targetSeconds) {
+        target = toDuration(targetSeconds);
+    }
+
+    // Tasks run at most once per frame, and only while enough of the frame budget is left
+    void addIdleTask(std::function<void()> task) {
+        idleTasks.push_back(std::move(task));
+    }
+
+    // Call once per frame, after display(). Runs idle tasks, then waits until the frame deadline.
+    void wait() {
+        Clock::time_point deadline = frameStart + target;
+
+        // Spend spare time on idle tasks, round robin so one slow task can't starve the others
+        for (size_t ran = 0; ran < idleTasks.size(); ++ran) {
+            if (deadline - Clock::now() <= 2 * spin) break;
+            idleTasks[nextIdleTask]();
+            nextIdleTask = (nextIdleTask + 1) % idleTasks.size();
+        }
+
+        // Sleep while there is more than the spin margin left, then spin the rest of the way
+        Clock::time_point now = Clock::now();
+        if (deadline - now > spin) {
+            std::this_thread::sleep_for(deadline - now - spin);
+        }
+        while (Clock::now() < deadline) {
+        }
+
+        // The next frame starts now, never back on a deadline that has already passed:
+        // after an overrun that would make a short catch-up frame and turn one hiccup into two
+        now = Clock::now();
+        recordFrame(std::chrono::duration<double>(now - frameStart).count());
+        frameStart = now;
+    }
+
+    // Start a new frame now without recording it, e.g. after blocking on window events while paused
+    void restart() {
+        frameStart = Clock::now();
+    }
+
+    // Pacing statistics since the last resetStats(), in seconds
+    int frames() const { return frameCount; }
+    double meanFrameTime() const { return frameCount ? sum / frameCount : 0.0; }
+    double jitter() const { // standard deviation of the frame time
+        if (frameCount < 2) return 0.0;
+        double mean = meanFrameTime();
+        return std::sqrt(std::max(0.0, sumSq / frameCount - mean * mean));
+    }
+    double worstDeviation() const { return maxDeviation; } // furthest any frame was from the target
+
+    void resetStats() {
+        frameCount = 0;
+        sum = 0.0;
+        sumSq = 0.0;
+        maxDeviation = 0.0;
+    }
+
+private:
+    Clock::duration target;
+    Clock::duration spin;
+    Clock::time_point frameStart;
+    std::vector<std::function<void()>> idleTasks;
+    size_t nextIdleTask = 0;
+
+    int frameCount = 0;
+    double sum = 0.0;
+    double sumSq = 0.0;
+    double maxDeviation = 0.0;
+
+    static Clock::duration toDuration(float seconds) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(seconds));
+    }
+
+    void recordFrame(double frameTime) {
+        ++frameCount;
+        sum += frameTime;
+        sumSq += frameTime * frameTime;
+        maxDeviation = std::max(maxDeviation, std::abs(frameTime - std::chrono::duration<double>(target).count()));
+    }
 };
+
 #ifndef TESTING // wrapping to avoid conflicts with test suite's main()
 int main() {
     const unsigned int WINDOW_W = 800;
@@ -137,7 +694,10 @@ int main() {
     // VideoMode in SFML 3 accepts a Vector2u
     sf::RenderWindow window(sf::VideoMode({WINDOW_W, WINDOW_H}), "EchoClash");
     window.requestFocus();
-    window.setFramerateLimit(60);
+    // Frame pacing is done by FramePacer instead of setFramerateLimit(), which only sleeps and gives uneven frames
+    const float targetFrameTime = 1.f / 60.f;
+    const int pacingReportFrames = 60; // refresh the pacing stats about once a second
+    FramePacer pacer(targetFrameTime);
 
     sf::Font font;
     bool fontLoaded = false;
@@ -152,6 +712,20 @@ int main() {
     sf::Text uiText(font, "", 18);
     uiText.setFillColor(sf::Color::White);
     uiText.setPosition(sf::Vector2f(350.f, 8.f));
+    HudStats hudStats;
+
+    // Frame pacing stats, shown on demand with F3
+    sf::Text pacingText(font, "", 14);
+    pacingText.setFillColor(sf::Color::White);
+    pacingText.setPosition(sf::Vector2f(350.f, 575.f));
+    bool showPacing = false;
+    bool wasF3Held = false; // track if F3 was held last frame
+
+    // Controls help never changes, so it lives in the static UI layer. The leading newline keeps it under the stats line
+    sf::Text helpText(font, "\nControls: Left/Right to rotate, Space to fire, Esc to pause,"
+                            "\n Up to charge echo, E to charge big echo, Q for sonar, F3 for frame stats", 18);
+    helpText.setFillColor(sf::Color::White);
+    helpText.setPosition(sf::Vector2f(350.f, 8.f));
 
     // pause menu text
     sf::Text pauseText(font, "PAUSED", 40);
@@ -166,11 +740,20 @@ int main() {
 
     // Random generator
     std::random_device rd;
-    std::mt19937 rng(rd());
-    std::uniform_real_distribution<float> angleDist(0.f, 2 * 3.14159265f);
+    // In a deterministic build the same seed and inputs give the same game.
+    // Replay a seed with ECHOCLASH_SEED=<number>, otherwise pick a random one
+    unsigned int simSeed = rd();
+    if (const char* seedEnv = std::getenv("ECHOCLASH_SEED")) {
+        if (!parseSeed(seedEnv, simSeed)) {
+            std::cerr << "Warning: ECHOCLASH_SEED is not a number, using a random seed.\n";
+        }
+    }
+    if (deterministicBuild) std::cout << "Simulation seed: " << simSeed << std::endl;
+    std::mt19937 rng(simSeed);
 
     // Turret parameters
-    float turretAngleDeg = 0.f; // degrees
+    Scalar turretAngle = toScalar(0.f); // degrees
+    float turretAngleDeg = 0.f; // follows turretAngle, for drawing and the sonar
     const float rotationSpeedDegPerSec = 140.f; // how fast it turns when holding keys
     const float barrelLength = 46.f;
     const float barrelThickness = 12.f;
@@ -200,8 +783,8 @@ int main() {
     sf::RectangleShape quitButton(sf::Vector2f(200.f, 80.f));
     resumeButton.setOrigin(sf::Vector2f(-300.f, -200.f));
     quitButton.setOrigin(sf::Vector2f(-300.f, -290.f));
-    resumeButton.setFillColor(sf::Color(100, 100, 100, 0));
-    quitButton.setFillColor(sf::Color(100, 100, 100, 0));
+    resumeButton.setFillColor(sf::Color(100, 100, 100, 255));
+    quitButton.setFillColor(sf::Color(100, 100, 100, 255));
 
     // Shooting
     const float bulletSpeed = 520.f;
@@ -230,6 +813,15 @@ int main() {
     const float bigWaveMaxCharge = 200.f; // Max radius when fully charged
     const float bigWaveChargeRate = 250.f; // how fast radius increases per second when E is held
     const float bigWaveShrinkRate = 150.f; // How fast big wave shrinks per second
+    // Sonar: Q key casts a fan of rays around the turret direction
+    bool wasQHeld = false; // track if Q was held last frame
+    const int sonarRayCount = 360; // rays per ping
+    const float sonarFanDeg = 90.f; // total width of the fan
+    const float sonarRange = 500.f; // how far a ray travels before giving up
+    const float sonarCooldown = 1.0f; // seconds between pings
+    const float sonarRevealTime = 4.f; // same as a regular echo hit
+    const float sonarDisplayTime = 0.3f; // how long the rays stay on screen
+    float timeSinceLastPing = sonarCooldown;
 
     bool wasEscapeHeld = false; // track if Escape was held last frame for pause menu
 
@@ -240,6 +832,8 @@ int main() {
     // vector for all echos: 
     // std::vector<std::variant<Echo, BigEcho>> allEchos; // std variant is needed to hold both types, as it dynamically tracks which type is stored
     std::vector<std::unique_ptr<EchoBase>> allEchos; //polymorphic approach
+    EnemyBVH enemyBVH;
+    Sonar sonar;
 
 
     int wave = 1;
@@ -261,6 +855,47 @@ int main() {
     heartTexture.setSmooth(true);
     window.draw(heartSprite);
 
+    // Static UI (hearts, charge bar backgrounds, controls help) and the pause menu are rendered once
+    // into textures and blitted each frame. Each widget gets its own small texture since they sit in
+    // different corners of the window. The hearts are re-rendered only when a life is lost.
+    CachedLayer heartsLayer;
+    CachedLayer chargeBarLayer;
+    CachedLayer bigWaveChargeBarLayer;
+    CachedLayer helpLayer;
+    CachedLayer pauseLayer;
+    sf::FloatRect pauseBounds = boundsUnion(resumeButton.getGlobalBounds(), quitButton.getGlobalBounds());
+    if (fontLoaded) {
+        pauseBounds = boundsUnion(pauseBounds, pauseText.getGlobalBounds());
+        pauseBounds = boundsUnion(pauseBounds, resumeText.getGlobalBounds());
+        pauseBounds = boundsUnion(pauseBounds, quitText.getGlobalBounds());
+    }
+    // Heart bounds at full health, they only shrink from here
+    bool uiCached = heartsLayer.create(heartSprite.getGlobalBounds(), [&](sf::RenderTarget& t) { t.draw(heartSprite); });
+    uiCached &= chargeBarLayer.create(chargeBarBackground.getGlobalBounds(), [&](sf::RenderTarget& t) { t.draw(chargeBarBackground); });
+    uiCached &= bigWaveChargeBarLayer.create(bigWaveChargeBarBackground.getGlobalBounds(),
+                                             [&](sf::RenderTarget& t) { t.draw(bigWaveChargeBarBackground); });
+    if (fontLoaded) {
+        uiCached &= helpLayer.create(helpText.getGlobalBounds(), [&](sf::RenderTarget& t) { t.draw(helpText); });
+    }
+    uiCached &= pauseLayer.create(pauseBounds, [&](sf::RenderTarget& t) {
+        t.draw(resumeButton);
+        t.draw(quitButton);
+        if (fontLoaded) {
+            t.draw(pauseText);
+            t.draw(resumeText);
+            t.draw(quitText);
+        }
+    });
+    if (!uiCached) {
+        std::cerr << "Warning: could not create UI render textures. Some UI will be drawn directly.\n";
+    }
+    bool redrawNeeded = true; // only used while paused: redraw on events or pause toggles, not every frame
+
+    // Deferred work for spare frame time: rebuild the enemy BVH about once a second so refits don't degrade it
+    pacer.addIdleTask([&]() {
+        if (enemyBVH.refitsSinceBuild >= 60) enemyBVH.build(enemies);
+    });
+
     // Helper to spawn a wave (spawn count increases each wave)
     float total_intensity = 0.f;
     auto spawnWave = [&](int waveNumber) {
@@ -278,22 +913,12 @@ int main() {
         enemies.reserve(count); // we reserve enough to store more enemies and avoid reallocations
         float spawnRadius = std::max(WINDOW_W, WINDOW_H) / 2.f + 50.f;
         for (int i = 0; i < count; ++i) {
-            float a = angleDist(rng); // random angle
-            sf::Vector2f pos = CENTER + sf::Vector2f(std::cos(a), std::sin(a)) * spawnRadius;
             Enemy e; //make an enemy
             e.shape = sf::CircleShape(14.f); // give it a circle shape 
             e.shape.setOrigin(sf::Vector2f(e.shape.getRadius(), e.shape.getRadius())); // by default origin is top-left, we are centering it
-            e.shape.setPosition(pos); // move he ORIGIN we made in the line above
-             // ... velocity setup ...
             e.set_visibility(false);         // ensure default
             e.visibilityTimer = 0.f;    // ensure default
-            // velocity towards center
-            sf::Vector2f dir = CENTER - pos; //vector pointing from the enemy position to the center. Center - enemy position
-            float len = std::sqrt(dir.x*dir.x + dir.y*dir.y); // find distance
-            if (len != 0) dir /= len; //prevent division by zero when enemy reaches center
-            // speed increases with wave number + some random variation
-            float speed = 40.f + 8.f * waveNumber + (std::uniform_real_distribution<float>(-10.f, 10.f)(rng));
-            e.set_velocity(dir * speed); //this makes the enemy actually move
+            placeEnemy(e, rng, waveNumber, toVec2(CENTER), toScalar(spawnRadius));
             e.shape.setFillColor(sf::Color(0, 0, 0, 0));
             enemies.push_back(e); // adds the enemy
         }
@@ -305,12 +930,30 @@ int main() {
 
     sf::Clock clock;
     while (window.isOpen()) { //actual game loop, runs until window is closed
+        // While paused and nothing changed, sleep until the next event instead of spinning at 60 Hz.
+        // The clock is restarted afterwards, so the wait doesn't show up in dt or the cooldown timers.
+        if (isPaused && !redrawNeeded) {
+            if (auto evOpt = window.waitEvent(sf::milliseconds(250))) {
+                redrawNeeded = true;
+                if (evOpt->is<sf::Event::Closed>()) {
+                    window.close();
+                    break;
+                }
+            }
+            pacer.restart(); // don't count the time spent blocked as a slow frame
+            clock.restart();
+        }
+
         // dt is the time since the last frame
-        float dt = clock.restart().asSeconds(); // we use time so the movement speed is not dependent on framerate
+        float frameTime = clock.restart().asSeconds(); // we use time so the movement speed is not dependent on framerate
+        // Deterministic builds step by a fixed dt instead, so every run sees the same sequence. The pacer keeps real frames close to it
+        float dt = deterministicBuild ? targetFrameTime : frameTime;
         timeSinceLastShot += dt; //control shooting cooldown
+        timeSinceLastPing += dt;
 
         while (auto evOpt = window.pollEvent()) { //checks if something happens in the window (like closing it)
             const auto &ev = *evOpt;
+            redrawNeeded = true;
             // use the is<T>() helper in SFML 3 to check event type
             if (ev.is<sf::Event::Closed>()) {
                 window.close(); //if the window is closed, we close it. woah.
@@ -327,10 +970,12 @@ int main() {
             if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Right)) {
                 rotationThisFrame += rotationSpeedDegPerSec * dt;
             }
-            turretAngleDeg += rotationThisFrame;
+            turretAngle += toScalar(rotationThisFrame);
             // stick whithin 0-360 range
-            if (turretAngleDeg > 360.f) turretAngleDeg -= 360.f;
-            if (turretAngleDeg < 0.f) turretAngleDeg += 360.f;
+            if (turretAngle > toScalar(360.f)) turretAngle -= toScalar(360.f);
+            if (turretAngle < toScalar(0.f)) turretAngle += toScalar(360.f);
+            turretAngleDeg = toFloat(turretAngle);
+            Vec2 turretDir(cosDeg(turretAngle), sinDeg(turretAngle)); // direction vector
 
             // Shooting: spacebar
             if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Space) && timeSinceLastShot >= fireCooldown) {
@@ -339,11 +984,8 @@ int main() {
                 Bullet b;
                 b.shape = sf::CircleShape(bulletRadius);
                 b.shape.setOrigin(sf::Vector2f(bulletRadius, bulletRadius)); // this centers the circle shape
-                b.shape.setPosition(CENTER); //shooting from center of turret
-                // compute direction from turretAngleDeg
-                float rad = turretAngleDeg * 3.14159265f / 180.f; // degrees to radians
-                sf::Vector2f dir(std::cos(rad), std::sin(rad)); // direction vector
-                b.velocity = dir * bulletSpeed; // velocity (makes the bullet move)
+                b.set_position(toVec2(CENTER)); //shooting from center of turret
+                b.velocity = turretDir * toScalar(bulletSpeed); // velocity (makes the bullet move)
                 b.shape.setFillColor(sf::Color::Yellow);
                 bullets.push_back(b); // add to bullets list
             }
@@ -363,14 +1005,15 @@ int main() {
                 // if W was released - spawn the echo with the accumulated charge
                 chargeBar.setSize(sf::Vector2f(barWidth, 0.f));
                 Echo ec;
-                ec.length = echoCharge * 2.f;
-                total_intensity += ec.length/4;
-                ec.elapsedTime = 0.f; // just spawned
-                float rad = turretAngleDeg * 3.14159265f / 180.f; // line must be perpendicular to turret direction
-                ec.velocity = sf::Vector2f(std::cos(rad), std::sin(rad));
+                float length = echoCharge * 2.f;
+                ec.length = toScalar(length);
+                total_intensity += length/4;
+                ec.elapsedTime = toScalar(0.f); // just spawned
+                ec.velocity = turretDir;
+                ec.position = toVec2(CENTER);
                 // Create rectangle perpendicular to direction (width = thickness, length = charge)
-                ec.shape = sf::RectangleShape(sf::Vector2f(ec.length, echoThickness));
-                ec.shape.setOrigin(sf::Vector2f(ec.length / 2.f, echoThickness / 2.f)); // center origin so it shrinks from both sides
+                ec.shape = sf::RectangleShape(sf::Vector2f(length, echoThickness));
+                ec.shape.setOrigin(sf::Vector2f(length / 2.f, echoThickness / 2.f)); // center origin so it shrinks from both sides
                 ec.shape.setPosition(CENTER);
                 ec.shape.setRotation(sf::degrees(turretAngleDeg + 90.f)); // perpendicular to turret direction
                 ec.shape.setFillColor(sf::Color::Cyan);
@@ -395,12 +1038,14 @@ int main() {
                 // if E was released - spawn the big wave with the accumulated charge
                 bigWaveChargeBar.setSize(sf::Vector2f(barWidth, 0.f));
                 BigEcho bec;
-                bec.radius = bigWaveCharge * 2.f;
-                total_intensity += bec.radius; // big wave intensity is much higher
-                bec.elapsedTime = 0.f; // just spawned
+                float radius = bigWaveCharge * 2.f;
+                bec.radius = toScalar(radius);
+                total_intensity += radius; // big wave intensity is much higher
+                bec.elapsedTime = toScalar(0.f); // just spawned
+                bec.position = toVec2(CENTER);
                 // Create circle that expands from center
-                bec.shape = sf::CircleShape(bec.radius);
-                bec.shape.setOrigin(sf::Vector2f(bec.radius, bec.radius)); // center origin
+                bec.shape = sf::CircleShape(radius);
+                bec.shape.setOrigin(sf::Vector2f(radius, radius)); // center origin
                 bec.shape.setPosition(CENTER);
                 bec.shape.setFillColor(sf::Color::Transparent);
                 bec.shape.setOutlineThickness(3.f);
@@ -411,11 +1056,26 @@ int main() {
             }
             wasEHeld = isEHeld;
 
+            // Keep the enemy BVH in sync with this frame's enemy positions (refit, or rebuild if enemies were added/removed)
+            enemyBVH.update(enemies);
+
+            // Sonar: Q key (ping on release)
+            bool isQHeld = sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Q);
+            if (!isQHeld && wasQHeld && timeSinceLastPing >= sonarCooldown) {
+                timeSinceLastPing = 0.f;
+                sonar.cast(enemyBVH, enemies, CENTER, turretAngleDeg, sonarFanDeg, sonarRayCount, sonarRange, echoSpeed);
+                sonar.reveal(enemies, sonarRevealTime);
+                sonar.displayTimer = sonarDisplayTime;
+                total_intensity += 30.f;
+            }
+            wasQHeld = isQHeld;
+            if (sonar.displayTimer > 0.f) sonar.displayTimer -= dt;
+
             // Update echos (shrinking rectangles that fly outward)
             for (size_t i = 0; i < echos.size(); ) {
                 echos[i].update(dt, echoShrinkRate, echoSpeed, echoThickness, CENTER);
                 // Remove when length is 0
-                if (echos[i].length <= 0.f) {
+                if (echos[i].length <= toScalar(0.f)) {
                     echos.erase(echos.begin() + i);
                 } else {
                     ++i;
@@ -426,7 +1086,7 @@ int main() {
             for (size_t i = 0; i < BigEchos.size(); ) {
                 BigEchos[i].update(dt, bigWaveShrinkRate, 0.f, 0.f, CENTER);
                 // Remove when radius is 0
-                if (BigEchos[i].radius <= 0.f) {
+                if (BigEchos[i].radius <= toScalar(0.f)) {
                     BigEchos.erase(BigEchos.begin() + i);
                 } else {
                     ++i;
@@ -466,7 +1126,7 @@ int main() {
             // Update bullets
             for (size_t i = 0; i < bullets.size(); ) {
                 Bullet &b = bullets[i]; //take current bullet
-                b.shape.move(b.velocity * dt); //move it according to its velocity
+                b.set_position(b.get_position() + b.velocity * toScalar(dt)); //move it according to its velocity
                 sf::Vector2f p = b.shape.getPosition(); // current position
                 // remove bullet if outside window bounds (with margin)
                 if (p.x < -50 || p.x > WINDOW_W + 50 || p.y < -50 || p.y > WINDOW_H + 50) { //erase if out of bounds
@@ -476,20 +1136,18 @@ int main() {
 
             // Keep updating all enemies
             for (size_t i = 0; i < enemies.size(); ++i) {
-                enemies[i].shape.move(enemies[i].get_velocity() * dt);
+                enemies[i].set_position(enemies[i].get_position() + enemies[i].get_velocity() * toScalar(dt));
             }
 
             // Collision detection: bullets vs enemies
             for (size_t bi = 0; bi < bullets.size(); ) {
                 bool bulletRemoved = false;
-                sf::Vector2f bp = bullets[bi].shape.getPosition(); // bullet position
+                Vec2 bp = bullets[bi].get_position(); // bullet position
+                Scalar br = toScalar(bullets[bi].shape.getRadius());
                 for (size_t ei = 0; ei < enemies.size(); ++ei) { // check against all enemies
-                    sf::Vector2f ep = enemies[ei].shape.getPosition(); // enemy position
-                    float dx = bp.x - ep.x; // difference in x
-                    float dy = bp.y - ep.y; // difference in y
-                    float dist2 = dx*dx + dy*dy;
-                    float rsum = bullets[bi].shape.getRadius() + enemies[ei].shape.getRadius(); // if distance squared is less than radius sum squared, we have a collision
-                    if (dist2 <= rsum * rsum) {
+                    // overlapping circles: distance between centers is at most the sum of the radii
+                    bool hit = circlesOverlap(bp, br, enemies[ei].get_position(), toScalar(enemies[ei].shape.getRadius()));
+                    if (hit) {
                         // hit: remove both bullet and enemy (one-shot kill)
                         enemies.erase(enemies.begin() + ei);
                         bulletRemoved = false;
@@ -501,11 +1159,9 @@ int main() {
 
             // Check if any enemy reached the center -> remove them (as if they hit the turret)
             for (size_t i = 0; i < enemies.size(); ) {
-                sf::Vector2f ep = enemies[i].shape.getPosition(); // enemy position
-                float dx = ep.x - CENTER.x;
-                float dy = ep.y - CENTER.y;
-                float dist2 = dx*dx + dy*dy; // distance squared to center
-                if (dist2 <= (turretRadius + enemies[i].shape.getRadius()) * (turretRadius + enemies[i].shape.getRadius())) {
+                bool reached = circlesOverlap(enemies[i].get_position(), toScalar(enemies[i].shape.getRadius()),
+                                              toVec2(CENTER), toScalar(turretRadius));
+                if (reached) {
                     // enemy reached turret: remove it
                     enemies.erase(enemies.begin() + i);
                     flashTimer = 15;
@@ -517,6 +1173,7 @@ int main() {
                         return 0;
                     } else {
                         heartSprite.setTextureRect(sf::IntRect({0, 0}, {hearts * 8000, 7000}));
+                        heartsLayer.render();
                     }
                 } else ++i;
             }
@@ -548,16 +1205,18 @@ int main() {
         bool isEscapeHeld = sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Escape);
         if (isEscapeHeld && !wasEscapeHeld) {
             isPaused = !isPaused; // toggle pause on/off
-            if (isPaused) {
-                resumeButton.setFillColor(sf::Color(100, 100, 100, 255));
-                quitButton.setFillColor(sf::Color(100, 100, 100, 255));
-            } else {
-                resumeButton.setFillColor(sf::Color(100, 100, 100, 0));
-                quitButton.setFillColor(sf::Color(100, 100, 100, 0));
-            }
+            redrawNeeded = true;
         }
         wasEscapeHeld = isEscapeHeld;
 
+        // Frame pacing stats toggle
+        bool isF3Held = sf::Keyboard::isKeyPressed(sf::Keyboard::Key::F3);
+        if (isF3Held && !wasF3Held) {
+            showPacing = !showPacing;
+            redrawNeeded = true;
+        }
+        wasF3Held = isF3Held;
+
         // Pause menu button clicks (outside isPaused check so it works while paused)
         if (isPaused && sf::Mouse::isButtonPressed(sf::Mouse::Button::Left)){
             std::cout << "mouse clicked!" << std::endl;
@@ -565,14 +1224,14 @@ int main() {
             if(resumeButton.getGlobalBounds().contains(mousePosition)) {
                 std::cout << "resuming game!" << std::endl;
                 isPaused = false;
-                resumeButton.setFillColor(sf::Color(100, 100, 100, 0));
-                quitButton.setFillColor(sf::Color(100, 100, 100, 0));
             } else if (quitButton.getGlobalBounds().contains(mousePosition)) {
                 return 0;
             }
         }
 
-        // Drawing
+        // Drawing (skipped while paused unless something changed)
+        if (isPaused && !redrawNeeded) continue;
+        redrawNeeded = false;
         window.clear(sf::Color(30, 30, 30));
 
         // Draw enemies
@@ -586,6 +1245,19 @@ int main() {
             window.draw(ec.shape);
         }
 
+        // Draw sonar rays from the last ping
+        if (sonar.displayTimer > 0.f) {
+            sf::VertexArray rays(sf::PrimitiveType::Lines, sonar.rayEnds.size() * 2);
+            for (size_t i = 0; i < sonar.rayEnds.size(); ++i) {
+                sf::Color c = sonar.hits[i].enemy >= 0 ? sf::Color(255, 200, 100, 120) : sf::Color(0, 255, 255, 40);
+                rays[2 * i].position = CENTER;
+                rays[2 * i].color = c;
+                rays[2 * i + 1].position = sonar.rayEnds[i];
+                rays[2 * i + 1].color = c;
+            }
+            window.draw(rays);
+        }
+
         // Draw big waves
         for (auto &bec : BigEchos) {
             window.draw(bec.shape);
@@ -596,15 +1268,14 @@ int main() {
             if (total_intensity < 0.f) total_intensity = 0.f;
         }
 
-        // Draw hearts
-        window.draw(heartSprite);
+        // Draw static UI: hearts, charge bar backgrounds, controls help
+        heartsLayer.drawTo(window);
+        chargeBarLayer.drawTo(window);
+        bigWaveChargeBarLayer.drawTo(window);
+        helpLayer.drawTo(window);
 
-        // Draw Charge Bar
-        window.draw(chargeBarBackground);
+        // Draw Charge Bars
         window.draw(chargeBar);
-
-        // Draw Big Wave Charge Bar
-        window.draw(bigWaveChargeBarBackground);
         window.draw(bigWaveChargeBar);
 
         // Draw turret: base circle
@@ -632,27 +1303,35 @@ int main() {
         // Draw loseLifeFlash
         window.draw(loseLifeFlash);
 
-        // Draw pause menu
-        window.draw(resumeButton);
-        window.draw(quitButton);
-        
-        // UI text
+        // UI text, only laid out again when a number changed
         if (fontLoaded) {
-            uiText.setString("Wave: " + std::to_string(wave) +
-                             "    Enemies: " + std::to_string((int)enemies.size()) +
-                             "    Bullets: " + std::to_string((int)bullets.size()) +
-                             "    Intensity: " + std::to_string((int)total_intensity) +
-                             "\nControls: Left/Right to rotate, Space to fire, Esc to pause,"
-                            "\n Up to charge echo, E to charge big echo");
-            window.draw(uiText);
-            if (isPaused) {
-                window.draw(pauseText);
-                window.draw(resumeText);
-                window.draw(quitText);
+            if (hudStats.update(wave, (int)enemies.size(), (int)bullets.size(), (int)total_intensity)) {
+                uiText.setString(hudStats.toString());
             }
+            window.draw(uiText);
+            if (showPacing) window.draw(pacingText);
+        }
+
+        // Draw pause menu
+        if (isPaused) {
+            pauseLayer.drawTo(window);
         }
 
         window.display();
+
+        pacer.wait();
+        if (pacer.frames() >= pacingReportFrames) {
+            // Only laid out once a second, and only while it's on screen
+            if (showPacing) {
+                std::ostringstream stats;
+                stats << std::fixed << std::setprecision(2)
+                      << "Frame: avg " << pacer.meanFrameTime() * 1000.0
+                      << " ms, jitter " << pacer.jitter() * 1000.0
+                      << " ms, worst " << pacer.worstDeviation() * 1000.0 << " ms off";
+                pacingText.setString(stats.str());
+            }
+            pacer.resetStats();
+        }
     }
     return 0;
 }
@@ -16,29 +16,32 @@ TEST_CASE("Enemy visibility") {
 TEST_CASE("Enemy velocity") {
     Enemy e;
     sf::Vector2f vel(3.f, -2.f);
-    e.set_velocity(vel);
-    CHECK(e.get_velocity().x == doctest::Approx(3.f));
-    CHECK(e.get_velocity().y == doctest::Approx(-2.f));
+    e.set_velocity(toVec2(vel));
+    CHECK(toVector2f(e.get_velocity()).x == doctest::Approx(3.f));
+    CHECK(toVector2f(e.get_velocity()).y == doctest::Approx(-2.f));
 }
 
 TEST_CASE("Echo hitsEnemy") {
     Enemy e;
     e.shape = sf::CircleShape(5.f);
     e.shape.setOrigin(sf::Vector2f(5.f, 5.f)); 
-    e.shape.setPosition(sf::Vector2f(50.f, 50.f)); 
+    e.set_position(toVec2(sf::Vector2f(50.f, 50.f)));
     
     Echo echo;
-    echo.length = 20.f;
-    echo.velocity = sf::Vector2f(1.f, 0.f);
-    echo.shape = sf::RectangleShape(sf::Vector2f(echo.length, 6.f));
-    echo.shape.setOrigin(sf::Vector2f(echo.length/2.f, 3.f)); 
-    echo.shape.setPosition(sf::Vector2f(50.f, 50.f));
-    echo.shape.setRotation(sf::degrees(0.f));
+    echo.length = toScalar(20.f);
+    echo.velocity = toVec2(sf::Vector2f(0.f, 1.f)); // travels down, so it lies along x
+    echo.position = toVec2(sf::Vector2f(50.f, 50.f));
     
     CHECK(echo.hitsEnemy(e, 6.f) == true);
+
+    // Within reach along the echo's length, but not across its thickness
+    e.set_position(toVec2(sf::Vector2f(62.f, 50.f)));
+    CHECK(echo.hitsEnemy(e, 6.f) == true);
+    e.set_position(toVec2(sf::Vector2f(50.f, 62.f)));
+    CHECK(echo.hitsEnemy(e, 6.f) == false);
     
     // Move enemy far away
-    e.shape.setPosition(sf::Vector2f(200.f, 200.f));  
+    e.set_position(toVec2(sf::Vector2f(200.f, 200.f)));
     CHECK(echo.hitsEnemy(e, 6.f) == false);
 }
 
@@ -46,45 +49,268 @@ TEST_CASE("BigEcho hitsEnemy") {
     Enemy e;
     e.shape = sf::CircleShape(5.f);
     e.shape.setOrigin(sf::Vector2f(5.f, 5.f));  
-    e.shape.setPosition(sf::Vector2f(100.f, 100.f));  
+    e.set_position(toVec2(sf::Vector2f(100.f, 100.f)));
     
     BigEcho be;
-    be.radius = 50.f;
-    be.shape = sf::CircleShape(be.radius);
-    be.shape.setOrigin(sf::Vector2f(be.radius, be.radius));  
-    be.shape.setPosition(sf::Vector2f(100.f, 100.f));
+    be.radius = toScalar(50.f);
+    be.position = toVec2(sf::Vector2f(100.f, 100.f));
     
     CHECK(be.hitsEnemy(e, 0.f) == true);
     
-    e.shape.setPosition(sf::Vector2f(200.f, 200.f));  
+    e.set_position(toVec2(sf::Vector2f(200.f, 200.f)));
     CHECK(be.hitsEnemy(e, 0.f) == false);
 }
 
 TEST_CASE("Echo update moves and shrinks") {
     Echo echo;
-    echo.length = 20.f;
-    echo.velocity = sf::Vector2f(1.f, 0.f);
-    echo.shape = sf::RectangleShape(sf::Vector2f(echo.length, 6.f));
-    echo.shape.setOrigin(sf::Vector2f(echo.length/2.f, 3.f));  
+    echo.length = toScalar(20.f);
+    echo.velocity = toVec2(sf::Vector2f(1.f, 0.f));
     
     sf::Vector2f center(0.f, 0.f);
     echo.update(1.f, 2.f, 10.f, 6.f, center);
     
-    CHECK(echo.length == doctest::Approx(18.f));
+    CHECK(toFloat(echo.length) == doctest::Approx(18.f));
     CHECK(echo.shape.getPosition().x == doctest::Approx(10.f));
     CHECK(echo.shape.getPosition().y == doctest::Approx(0.f));
 }
 
 TEST_CASE("BigEcho update shrinks") {
     BigEcho be;
-    be.radius = 40.f;
-    be.shape = sf::CircleShape(be.radius);
-    be.shape.setOrigin(sf::Vector2f(be.radius, be.radius)); 
+    be.radius = toScalar(40.f);
     
     sf::Vector2f center(0.f, 0.f);
     be.update(1.f, 5.f, 0.f, 0.f, center);
     
-    CHECK(be.radius == doctest::Approx(35.f));
+    CHECK(toFloat(be.radius) == doctest::Approx(35.f));
     CHECK(be.shape.getPosition().x == doctest::Approx(0.f));
     CHECK(be.shape.getPosition().y == doctest::Approx(0.f));
-}
\ No newline at end of file
+}
+
+static Enemy makeEnemyAt(float x, float y, float r = 10.f) {
+    Enemy e;
+    e.shape = sf::CircleShape(r);
+    e.shape.setOrigin(sf::Vector2f(r, r));
+    e.set_position(toVec2(sf::Vector2f(x, y)));
+    return e;
+}
+
+TEST_CASE("EnemyBVH raycast finds nearest enemy") {
+    std::vector<Enemy> enemies;
+    for (int i = 0; i < 50; ++i) {
+        enemies.push_back(makeEnemyAt(100.f + 40.f * i, 0.f));
+    }
+    EnemyBVH bvh;
+    bvh.update(enemies);
+
+    float dist = 0.f;
+    CHECK(bvh.raycast(enemies, sf::Vector2f(0.f, 0.f), sf::Vector2f(1.f, 0.f), 5000.f, dist) == 0);
+    CHECK(dist == doctest::Approx(90.f));
+
+    // Pointing away hits nothing
+    CHECK(bvh.raycast(enemies, sf::Vector2f(0.f, 0.f), sf::Vector2f(-1.f, 0.f), 5000.f, dist) == -1);
+    CHECK(dist == doctest::Approx(5000.f));
+}
+
+TEST_CASE("EnemyBVH refit follows moving enemies") {
+    std::vector<Enemy> enemies;
+    for (int i = 0; i < 20; ++i) {
+        enemies.push_back(makeEnemyAt(100.f + 40.f * i, 0.f));
+    }
+    EnemyBVH bvh;
+    bvh.update(enemies);
+
+    // Move the last enemy onto the downward ray, same count so the tree is only refit
+    enemies[19].set_position(toVec2(sf::Vector2f(0.f, 200.f)));
+    size_t nodeCount = bvh.nodes.size();
+    bvh.update(enemies);
+    CHECK(bvh.nodes.size() == nodeCount);
+
+    float dist = 0.f;
+    CHECK(bvh.raycast(enemies, sf::Vector2f(0.f, 0.f), sf::Vector2f(0.f, 1.f), 5000.f, dist) == 19);
+    CHECK(dist == doctest::Approx(190.f));
+}
+
+TEST_CASE("Sonar cast reports hits and reveals enemies") {
+    std::vector<Enemy> enemies;
+    enemies.push_back(makeEnemyAt(100.f, 0.f));  // straight ahead
+    enemies.push_back(makeEnemyAt(-100.f, 0.f)); // behind, outside the fan
+    EnemyBVH bvh;
+    bvh.update(enemies);
+
+    Sonar sonar;
+    sonar.cast(bvh, enemies, sf::Vector2f(0.f, 0.f), 0.f, 90.f, 181, 500.f, 500.f);
+    CHECK(sonar.hits.size() == 181);
+    CHECK(sonar.hits[90].enemy == 0);
+    CHECK(sonar.hits[90].returnDelay == doctest::Approx(2.f * 90.f / 500.f));
+    CHECK(sonar.hits[0].enemy == -1);
+    CHECK(sonar.hits[0].returnDelay == doctest::Approx(0.f));
+
+    // A negative ray count just casts nothing
+    Sonar empty;
+    empty.cast(bvh, enemies, sf::Vector2f(0.f, 0.f), 0.f, 90.f, -5, 500.f, 500.f);
+    CHECK(empty.hits.empty());
+
+    sonar.reveal(enemies, 4.f);
+    CHECK(enemies[0].visibilityTimer == doctest::Approx(4.f));
+    CHECK(enemies[1].visibilityTimer == doctest::Approx(0.f));
+}
+
+TEST_CASE("HudStats only reports changes") {
+    HudStats hud;
+    CHECK(hud.update(1, 3, 0, 10) == true);
+    CHECK(hud.update(1, 3, 0, 10) == false);
+    CHECK(hud.update(1, 2, 0, 10) == true);
+    CHECK(hud.toString() == "Wave: 1    Enemies: 2    Bullets: 0    Intensity: 10");
+}
+
+TEST_CASE("FramePacer hits target frame time and runs idle tasks") {
+    FramePacer pacer(0.005f, 0.001f);
+    int idleRuns = 0;
+    pacer.addIdleTask([&]() { ++idleRuns; });
+    for (int i = 0; i < 20; ++i) pacer.wait();
+
+    CHECK(pacer.frames() == 20);
+    CHECK(pacer.meanFrameTime() >= 0.0045);
+    CHECK(pacer.meanFrameTime() <= 0.0065);
+    CHECK(idleRuns > 0);
+
+    pacer.resetStats();
+    CHECK(pacer.frames() == 0);
+    CHECK(pacer.jitter() == doctest::Approx(0.0));
+}
+
+TEST_CASE("Fixed point arithmetic") {
+    Fixed a = Fixed::fromFloat(2.5f);
+    Fixed b = Fixed::fromInt(-4);
+    CHECK((a + b).toFloat() == doctest::Approx(-1.5f));
+    CHECK((a * b).toFloat() == doctest::Approx(-10.f));
+    CHECK((b / a).toFloat() == doctest::Approx(-1.6f));
+    CHECK((a / 2).toFloat() == doctest::Approx(1.25f));
+    CHECK(Fixed::fromFloat(0.1f).raw == 6554);
+}
+
+TEST_CASE("Table trig matches std trig") {
+    for (int deg = -720; deg <= 720; deg += 15) {
+        float rad = deg * 3.14159265f / 180.f;
+        CHECK(fixedSinDeg(Fixed::fromInt(deg)).toFloat() == doctest::Approx(std::sin(rad)).epsilon(0.01));
+        CHECK(fixedCosDeg(Fixed::fromInt(deg)).toFloat() == doctest::Approx(std::cos(rad)).epsilon(0.01));
+    }
+    CHECK(fixedSinDeg(Fixed::fromInt(90)) == Fixed::fromInt(1));
+    CHECK(fixedCosDeg(Fixed::fromInt(180)) == Fixed::fromInt(-1));
+}
+
+TEST_CASE("Fixed collision kernels agree with float versions") {
+    FixedVec2 a = FixedVec2::fromVector2f(sf::Vector2f(50.f, 50.f));
+    CHECK(fixedCirclesOverlap(a, Fixed::fromInt(5), FixedVec2::fromVector2f(sf::Vector2f(58.f, 50.f)), Fixed::fromInt(4)) == true);
+    CHECK(fixedCirclesOverlap(a, Fixed::fromInt(5), FixedVec2::fromVector2f(sf::Vector2f(60.f, 50.f)), Fixed::fromInt(4)) == false);
+
+    // Same setup as "Echo hitsEnemy": 20x6 rectangle at (50, 50) with no rotation
+    FixedVec2 axis(Fixed::fromInt(1), Fixed::fromInt(0));
+    Fixed halfW = Fixed::fromInt(10);
+    Fixed halfH = Fixed::fromInt(3);
+    CHECK(fixedRectHitsCircle(a, axis, halfW, halfH, a, Fixed::fromInt(5)) == true);
+    CHECK(fixedRectHitsCircle(a, axis, halfW, halfH, FixedVec2::fromVector2f(sf::Vector2f(200.f, 200.f)), Fixed::fromInt(5)) == false);
+
+    // Rotated 90 degrees: the long side now runs along y
+    FixedVec2 up(fixedCosDeg(Fixed::fromInt(90)), fixedSinDeg(Fixed::fromInt(90)));
+    FixedVec2 below = FixedVec2::fromVector2f(sf::Vector2f(50.f, 62.f));
+    CHECK(fixedRectHitsCircle(a, up, halfW, halfH, below, Fixed::fromInt(5)) == true);
+    CHECK(fixedRectHitsCircle(a, axis, halfW, halfH, below, Fixed::fromInt(5)) == false);
+}
+
+TEST_CASE("Simulation helpers") {
+    // Run against float in a normal build and fixed point in a deterministic one
+    CHECK(toFloat(sinDeg(toScalar(90.f))) == doctest::Approx(1.f).epsilon(0.001));
+    CHECK(toFloat(cosDeg(toScalar(180.f))) == doctest::Approx(-1.f).epsilon(0.001));
+
+    Vec2 a = toVec2(sf::Vector2f(50.f, 50.f));
+    CHECK(circlesOverlap(a, toScalar(5.f), toVec2(sf::Vector2f(58.f, 50.f)), toScalar(4.f)) == true);
+    CHECK(circlesOverlap(a, toScalar(5.f), toVec2(sf::Vector2f(60.f, 50.f)), toScalar(4.f)) == false);
+
+    Vec2 alongY(cosDeg(toScalar(90.f)), sinDeg(toScalar(90.f)));
+    CHECK(rectHitsCircle(a, alongY, toScalar(10.f), toScalar(3.f), toVec2(sf::Vector2f(50.f, 62.f)), toScalar(5.f)) == true);
+    CHECK(rectHitsCircle(a, alongY, toScalar(10.f), toScalar(3.f), toVec2(sf::Vector2f(62.f, 50.f)), toScalar(5.f)) == false);
+}
+
+TEST_CASE("Spawned enemies head for the center") {
+    std::mt19937 rng(7);
+    sf::Vector2f center(400.f, 300.f);
+    for (int i = 0; i < 100; ++i) {
+        Enemy e;
+        placeEnemy(e, rng, 2, toVec2(center), toScalar(450.f));
+        sf::Vector2f offset = toVector2f(e.get_position()) - center;
+        sf::Vector2f vel = toVector2f(e.get_velocity());
+        float speed = std::sqrt(vel.x * vel.x + vel.y * vel.y);
+        CHECK(std::sqrt(offset.x * offset.x + offset.y * offset.y) == doctest::Approx(450.f).epsilon(0.001));
+        CHECK(speed >= 45.9f);
+        CHECK(speed <= 66.1f);
+        CHECK(vel.x * offset.x + vel.y * offset.y == doctest::Approx(-speed * 450.f).epsilon(0.001)); // straight inwards
+        CHECK(e.shape.getPosition() == toVector2f(e.get_position()));
+    }
+}
+
+TEST_CASE("Seed parsing") {
+    unsigned int seed = 7;
+    CHECK(parseSeed("12345", seed) == true);
+    CHECK(seed == 12345u);
+    CHECK(parseSeed("4294967295", seed) == true);
+    CHECK(seed == 4294967295u);
+
+    seed = 7;
+    CHECK(parseSeed("-1", seed) == false);
+    CHECK(parseSeed(" -1", seed) == false);
+    CHECK(parseSeed("4294967296", seed) == false);
+    CHECK(parseSeed("99999999999999999999999", seed) == false);
+    CHECK(parseSeed("12abc", seed) == false);
+    CHECK(parseSeed("", seed) == false);
+    CHECK(seed == 7u); // failures leave the seed alone
+}
+
+#ifdef DETERMINISTIC
+TEST_CASE("Deterministic simulation is bit-identical") {
+    // Spawns, moves and collides a few hundred entities the way the game loop does, and hashes every
+    // fixed-point value and hit result. The expected hash must come out the same on every compiler and flag set
+    const sf::Vector2f center(400.f, 300.f);
+    const float dt = 1.f / 60.f;
+    std::mt19937 rng(42);
+
+    std::vector<Enemy> enemies(300);
+    for (Enemy& e : enemies) {
+        e.shape = sf::CircleShape(14.f);
+        placeEnemy(e, rng, 3, toVec2(center), toScalar(450.f));
+    }
+    std::vector<Bullet> bullets(16);
+    for (size_t i = 0; i < bullets.size(); ++i) {
+        Scalar angle = toScalar(22.5f * i);
+        bullets[i].shape = sf::CircleShape(4.f);
+        bullets[i].set_position(toVec2(center));
+        bullets[i].velocity = Vec2(cosDeg(angle), sinDeg(angle)) * toScalar(520.f);
+    }
+    Echo echo;
+    echo.length = toScalar(300.f);
+    echo.velocity = Vec2(cosDeg(toScalar(37.3f)), sinDeg(toScalar(37.3f)));
+    BigEcho bigEcho;
+    bigEcho.radius = toScalar(400.f);
+
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a
+    auto mix = [&](uint64_t v) { hash = (hash ^ v) * 1099511628211ULL; };
+    for (int step = 0; step < 300; ++step) {
+        echo.update(dt, 100.f, 520.f, 6.f, center);
+        bigEcho.update(dt, 150.f, 0.f, 0.f, center);
+        for (Bullet& b : bullets) b.set_position(b.get_position() + b.velocity * toScalar(dt));
+        for (Enemy& e : enemies) {
+            e.set_position(e.get_position() + e.get_velocity() * toScalar(dt));
+            Vec2 p = e.get_position();
+            mix((uint32_t)p.x.raw);
+            mix((uint32_t)p.y.raw);
+            mix(echo.hitsEnemy(e, 6.f));
+            mix(bigEcho.hitsEnemy(e, 0.f));
+            mix(circlesOverlap(p, toScalar(14.f), toVec2(center), toScalar(18.f)));
+            for (const Bullet& b : bullets) {
+                mix(circlesOverlap(b.get_position(), toScalar(4.f), p, toScalar(14.f)));
+            }
+        }
+    }
+    CHECK(hash == 0xce87ab533ee2e199ULL);
+}
+#endif